@@ -55,6 +55,13 @@ void bubble_set_float(struct bubble *b, uint16_t value, uint8_t dp)
   b->dp = dp;
 }
 
+void bubble_set_overload(struct bubble *b)
+{
+  // Anything above 9 is displayed that way
+  for (uint8_t d = 0; d < SIZEOF_ARRAY(b->digits); d++) b->digits[d] = 10U;
+  b->dp = SIZEOF_ARRAY(b->digits);
+}
+
 static void bubble_off(void)
 {
   set_segments(0);
@@ -34,6 +34,9 @@ static inline void bubble_ctor(struct bubble *b)
 // dp: after which digit to set the decimal point (if between 0 and 3).
 void bubble_set_float(struct bubble *, uint16_t value, uint8_t dp);
 
+// Light the top, middle and bottom segments of all digits, no decimal point.
+void bubble_set_overload(struct bubble *);
+
 // digit must be between 0 and 3, value between 0 and 9.
 void bubble_set(uint8_t digit, uint8_t value, bool dp);
 
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Check that no code linked into a WITH_FAST_INT0 firmware, other than ours,
+# uses r2 or r3. We compile with -ffixed-r2 -ffixed-r3, but libgcc and libc
+# (such as __udivmodsi4, __mulsi3 or eeprom_read_block) were not.
+#
+# Usage: check_fixed_regs.sh geiger.elf geiger.o libcommon.a
+
+if test $# -lt 2 ; then
+	echo "Usage: $0 firmware.elf objects..." >&2
+	exit 1
+fi
+
+elf=$1
+shift
+
+# First our functions (from the objects), then the disassembly of the firmware
+{ avr-nm --defined-only "$@" && echo "--" && avr-objdump -d "$elf" ; } | awk -v elf="$elf" '
+!dis {
+	if ($0 == "--") dis = 1
+	else if (NF == 3 && $2 ~ /^[tT]$/) ours["<" $3 ">:"] = 1
+	next
+}
+
+# Function headers, such as:
+# 00000046 <__udivmodsi4>:
+/^[0-9a-f]+ <.*>:$/ {
+	f = $2
+	next
+}
+
+!(f in ours) && /[\t ,]r[23](,|[\t ]|$)/ {
+	printf "%s: %s uses r2 or r3: %s\n", elf, f, $0 > "/dev/stderr"
+	bad = 1
+}
+
+END {
+	if (! dis) {
+		print "Cannot list the functions of the objects" > "/dev/stderr"
+		exit 1
+	}
+	exit bad
+}'
@@ -0,0 +1,32 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "miscmacs.h"
+#include "cmd.h"
+#ifdef WITH_STACK
+#   include "stack.h"
+#endif
+
+extern inline void cmd_ctor(struct cmd *);
+
+bool cmd_feed(struct cmd *c, char x)
+{
+# ifdef WITH_STACK
+  stack_mark(); // a leaf of the RX path
+# endif
+  if (x == '\r' || x == '\n') {
+    bool const complete = c->name != 0;
+    c->name = 0;
+    return complete;
+  }
+
+  if (x >= 'a' && x <= 'z') {
+    c->name = x;
+    c->arg = 0;
+  } else if (x >= '0' && x <= '9' && c->name) {
+    uint16_t const arg = c->arg * 10U + (x - '0');
+    c->arg = arg < UINT8_MAX ? arg : UINT8_MAX;
+  } else {  // garbage: ignore the whole command
+    c->name = 0;
+  }
+  return false;
+}
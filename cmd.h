@@ -0,0 +1,26 @@
+/* Incremental parser for the commands received over the serial link.
+ * A command is a letter optionally followed by a decimal argument and
+ * terminated by CR or LF, for instance "i60\n". Chars are parsed as they
+ * arrive, so there is no line buffer.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef CMD_H_261018
+#define CMD_H_261018
+
+struct cmd {
+  char name;  // 0 while no command is being received
+  uint8_t arg;  // saturates at UINT8_MAX, 0 if omitted
+};
+
+// Also used to drop the command being received.
+static inline void cmd_ctor(struct cmd *c)
+{
+  c->name = 0;
+}
+
+// Feed the next received char. Returns true when a command is complete,
+// in which case name and arg are those of the command.
+bool cmd_feed(struct cmd *, char);
+
+#endif
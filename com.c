@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "miscmacs.h"
+#include "com.h"
+
+// Most significant digit first, so that the reports sent from TIMER1 need
+// no buffer on the stack (see STACK_RESERVE in geiger.c).
+void com_putuint(uint16_t x)
+{
+  bool leading = true;
+  for (uint16_t p = 10000U; p > 1U; p /= 10U) {
+    div_t const r = udiv(x, p);
+    if (r.quot || ! leading) {
+      com_putchar(r.quot + '0');
+      leading = false;
+    }
+    x = r.rem;
+  }
+  com_putchar(x + '0');
+}
+
+void com_putulong(uint32_t x)
+{
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    ldiv_t const r = uldiv(x, 10U);
+    digits[n++] = r.rem + '0';
+    x = r.quot;
+  } while (x);
+  while (n) com_putchar(digits[--n]);
+}
+
+void com_print_dose(struct dose_report const *r)
+{
+  if (r->foldback) com_putchar('!');
+  if (r->cps_overflow) com_putchar('>');
+  com_putuint(r->cps);
+  com_putchar(',');
+  if (r->cpm_overflow) com_putchar('>');
+  com_putuint(r->cpm);
+  com_putchar(',');
+  com_putuint(r->siv);
+  com_putchar('\n');
+}
@@ -0,0 +1,22 @@
+/* Serial reporting.
+ * The output primitive com_putchar must be provided by the program:
+ * the UART in geiger.c, stdout in replay.c.
+ */
+#include <stdint.h>
+#include "dose.h"
+#ifndef COM_H_261018
+#define COM_H_261018
+
+void com_putchar(char);
+
+void com_putuint(uint16_t);
+
+// Only for the lifetime totals, printed from main: its buffer is twice as
+// large.
+void com_putulong(uint32_t);
+
+// Print the CSV line: CPS, CPM, uSv/hr (x1000), prefixed with '!' if the
+// tube may be saturated.
+void com_print_dose(struct dose_report const *);
+
+#endif
@@ -0,0 +1,26 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "miscmacs.h"
+#include "dose.h"
+
+extern inline void dose_ctor(struct dose *);
+
+void dose_second(struct dose *d, uint8_t cps, struct dose_report *r)
+{
+  d->buffer[d->idx] = cps;   // save current sample to buffer (replacing old value)
+  if (++d->idx >= SIZEOF_ARRAY(d->buffer)) d->idx = 0;
+
+  r->cps = cps;
+  r->cps_overflow = cps >= UINT8_MAX;
+  r->cpm_overflow = false;
+  r->foldback = false;
+
+  uint16_t cpm = 0;
+  for (uint8_t i = 0; i < SIZEOF_ARRAY(d->buffer); i++) {
+    if (d->buffer[i] == UINT8_MAX) r->cpm_overflow = true;
+    cpm += d->buffer[i];
+  }
+  cpm *= 60U / DOSE_WINDOW;  // since we have only 30secs
+  r->cpm = cpm;
+  r->siv = dose_siv_of_cpm(cpm);
+}
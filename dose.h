@@ -0,0 +1,46 @@
+/* Running average of the GM counts and conversion into a dose rate.
+ * This is what every_second used to do inline. It does not touch any
+ * AVR register so that it can also be built natively (see replay.c).
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef DOSE_H_261018
+#define DOSE_H_261018
+
+#define DOSE_WINDOW 30U // seconds of history, must divide 60
+
+struct dose {
+  uint8_t buffer[DOSE_WINDOW]; // the sample buffer. Any 255 means overflow.
+  uint8_t idx;  // sample buffer index
+};
+
+// What the device displays and reports for a given second
+struct dose_report {
+  uint8_t cps;
+  bool cps_overflow;  // cps reached UINT8_MAX
+  bool cpm_overflow;  // some sample of the window did
+  uint16_t cpm;
+  uint16_t siv; // 1000*uSv/hr, as displayed
+  bool foldback;  // the tube may be saturated (see foldback.h)
+};
+
+static inline void dose_ctor(struct dose *d)
+{
+  for (uint8_t i = 0; i < DOSE_WINDOW; i++) d->buffer[i] = 0;
+  d->idx = 0;
+}
+
+// Add the counts of the last second and compute the new report.
+void dose_second(struct dose *, uint8_t cps, struct dose_report *);
+
+// Convert a CPM into 1000*uSv/hr (truncated to 16 bits, as on the display).
+static inline uint16_t dose_siv_of_cpm(uint16_t cpm)
+{
+  // Display CPM * 0.0057 aka something close to uSv/hr.
+  // We keep one digit for the integral part and 3 for the decimal part
+  // (otherwise you have bigger problems).
+  // So we actually want 1000*uSv/hr. We thus mult by 5.7.
+  return (cpm * 1459UL) >> 8U;
+}
+
+#endif
@@ -6,6 +6,9 @@
 #include "miscmacs.h"
 #include "event.h"
 #include "cpp.h"
+#ifdef WITH_STACK
+#   include "stack.h"
+#endif
 
 static struct event *volatile next_event = NULL;
 
@@ -51,6 +54,9 @@ void event_register(struct event *e, void (*cb)(struct event *), uint32_t delay)
 {
   uint8_t const saved_sregs = SREG;
   cli();
+# ifdef WITH_STACK
+  stack_mark(); // a leaf of all paths
+# endif
   // next_event is not volatile any more
 
   BIT_SET(PORTB, PB4);
@@ -100,10 +106,16 @@ void event_register(struct event *e, void (*cb)(struct event *), uint32_t delay)
 // First version : blocking ISR (TODO: allow interrupts while in cb())
 ISR(TIMER1_COMPA_vect)
 {
+#   ifdef WITH_STACK
+    stack_enter(STACK_TIMER1);
+#   endif
     if (next_event) {
         event_run_next();
         event_program_timer();
     }
+#   ifdef WITH_STACK
+    stack_leave();
+#   endif
 }
 
 extern inline void event_ctor(struct event *ev);
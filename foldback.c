@@ -0,0 +1,34 @@
+#include <stdlib.h>
+#include "miscmacs.h"
+#include "foldback.h"
+
+extern inline void foldback_ctor(struct foldback *);
+
+bool foldback_second(struct foldback *f, uint8_t cps, bool pin_low)
+{
+  bool const collapsed = f->peak >= FOLDBACK_HIGH && cps < f->peak / FOLDBACK_DROP;
+
+  // Decay by 1/8th of the difference per second, so that a collapse is
+  // still spotted for a few seconds (from 255 to FOLDBACK_HIGH in ~7s).
+  // Once spotted, keep the peak for as long as the collapse lasts.
+  if (cps >= f->peak) {
+    f->peak = cps;
+  } else if (! (f->hold && collapsed)) {
+    f->peak -= (f->peak - cps + 7U) >> 3U;
+  }
+
+  // A single sample is found low every now and then at any rate
+  if (pin_low && cps < FOLDBACK_LOW) {
+    if (f->low < FOLDBACK_LOW_SECONDS) f->low ++;
+  } else {
+    f->low = 0;
+  }
+
+  if (f->low >= FOLDBACK_LOW_SECONDS || collapsed) {
+    f->hold = FOLDBACK_HOLD;
+  } else if (f->hold) {
+    f->hold --;
+  }
+
+  return f->hold > 0;
+}
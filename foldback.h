@@ -0,0 +1,44 @@
+/* Detection of GM tube fold-back (paralysis).
+ *
+ * In very high fields the tube can stay in discharge, so that the CPS
+ * collapses while the dose is actually at its highest. We suspect this
+ * when the CPS suddenly drops from a high rate to nearly nothing, or when
+ * the pulse line is found low (ie. within a pulse, that normally lasts
+ * ~100us) for several seconds in a row while almost no pulse are counted.
+ *
+ * After a collapse the peak rate is kept as long as the CPS stays below
+ * it, so that the warning lasts as long as the tube is paralyzed. This
+ * cannot be told apart from the source being suddenly removed, so that
+ * the warning then also stays until the counts come back.
+ *
+ * This runs once per second and so costs nothing per pulse.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef FOLDBACK_H_261018
+#define FOLDBACK_H_261018
+
+#define FOLDBACK_HIGH 128U  // CPS above which the tube may be near saturation
+#define FOLDBACK_DROP 16U // collapse ratio from that rate
+#define FOLDBACK_LOW 4U // CPS below which a low pulse line is suspicious
+#define FOLDBACK_LOW_SECONDS 3U // consecutive such seconds before warning
+#define FOLDBACK_HOLD 30U // seconds to keep warning after last detection
+
+struct foldback {
+  uint8_t peak; // recent max CPS, slowly decaying
+  uint8_t hold; // seconds left warning
+  uint8_t low;  // consecutive seconds with a suspicious low pulse line
+};
+
+static inline void foldback_ctor(struct foldback *f)
+{
+  f->peak = 0;
+  f->hold = 0;
+  f->low = 0;
+}
+
+// Account for the last second. pin_low tells if the pulse line was low
+// when sampled. Returns true if the count must not be trusted.
+bool foldback_second(struct foldback *, uint8_t cps, bool pin_low);
+
+#endif
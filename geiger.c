@@ -85,38 +85,159 @@
 #include "event.h"
 #include "shift_register.h"
 #include "bubble_led.h"
+#include "dose.h"
+#include "com.h"
+#ifdef WITH_PERSIST
+#   include "persist.h"
+#endif
+#ifdef WITH_HISTORY
+#   include "history.h"
+#endif
+#ifdef WITH_FOLDBACK
+#   include "foldback.h"
+#endif
+#ifdef WITH_CMD
+#   ifndef WITH_COM
+#       error "WITH_CMD requires WITH_COM"
+#   endif
+#   include "cmd.h"
+#   include "summary.h"
+#endif
+#ifdef WITH_STACK
+#   ifndef WITH_COM
+#       error "WITH_STACK requires WITH_COM"
+#   endif
+#   include "stack.h"
+#endif
 
 // Defines
 #define THRESHOLD   1000  // CPM threshold for fast avg mode
 #define SCALE_FACTOR  57    //  CPM to uSv/hr conversion factor (x10,000 to avoid float)
+#define REPORT_INTERVAL 1   // initial seconds between serial reports (WITH_CMD)
+#define STACK_REPORT_PERIOD 60 // seconds between stack reports (WITH_STACK)
+#define HORIZON HISTORY_NONE  // averaging horizon, see history.h (WITH_HISTORY)
 
 // Global variables
+#ifdef WITH_FAST_INT0
+// Pinned in a register so that the INT0 ISR can be reduced to a few
+// instructions (see below). Only ever accessed with interrupts disabled.
+register uint8_t cps asm("r2");  // number of GM events that has occurred this second
+#define PULSE_FLAG 0  // set in GPIOR0 by INT0 to have main bip
+#else
 static volatile uint8_t cps;     // number of GM events that has occurred this second
+#endif
 
 static struct bubble bubble;
+static struct dose dose;
+#ifdef WITH_HISTORY
+static struct history history;
+#endif
+#ifdef WITH_FOLDBACK
+static struct foldback foldback;
+#endif
+#ifdef WITH_CMD
+static struct summary summary;
+static struct cmd cmd;
+#endif
+#ifdef WITH_STACK
+static uint8_t stack_report_in = STACK_REPORT_PERIOD; // seconds
+#endif
+
+/* RAM budget
+ * The linker believes we have way more than the 128 bytes of the ATtiny2313,
+ * so we add up here everything that's statically allocated and check that it
+ * leaves enough for the stack. Its deepest path is a report sent from
+ * TIMER1, counted frame by frame (return addresses included):
+ *   main, called from the C runtime: PC                                   2
+ *   TIMER1_COMPA_vect: PC, r0, r1, SREG and the 12 call-clobbered regs  17
+ *   every_second, called from event_run_next: PC, struct dose_report,
+ *     Y                                                                12
+ *   com_print_dose or summary_second: PC, saved regs                      6
+ *   com_putuint: PC, saved regs                                           7
+ *   com_putchar: PC                                                       2
+ * Without WITH_COM, the display and history updates called from every_second
+ * take no more than 11 bytes, leaving 2 + 17 + 12 + 11.
+ * Check these against what WITH_STACK measures (see stack_report.sh) when
+ * changing the compiler or every_second.
+ * With WITH_COM, this leaves room for either WITH_CMD or WITH_PERSIST, but
+ * not WITH_HISTORY. */
+#ifdef WITH_COM
+#   define STACK_RESERVE 46U
+#else
+#   define STACK_RESERVE 42U
+#endif
+
+#define RAM_BASE (sizeof(cps) + sizeof(bubble) + sizeof(dose) + \
+  sizeof(every_second_e) + sizeof(bip_stop_e) + \
+  sizeof(struct event *)) // that last one is event.c's next_event
+#ifdef WITH_PERSIST
+#   define RAM_PERSIST PERSIST_RAM
+#else
+#   define RAM_PERSIST 0U
+#endif
+#ifdef WITH_HISTORY
+#   define RAM_HISTORY sizeof(history)
+#else
+#   define RAM_HISTORY 0U
+#endif
+#ifdef WITH_FOLDBACK
+#   define RAM_FOLDBACK sizeof(foldback)
+#else
+#   define RAM_FOLDBACK 0U
+#endif
+#ifdef WITH_CMD
+#   define RAM_CMD (sizeof(summary) + sizeof(cmd))
+#else
+#   define RAM_CMD 0U
+#endif
+#ifdef WITH_STACK
+#   define RAM_STACK (sizeof(stack_depth) + sizeof(stack_path) + sizeof(stack_report_in))
+#else
+#   define RAM_STACK 0U
+#endif
+#define RAM_STATIC (RAM_BASE + RAM_PERSIST + RAM_HISTORY + RAM_FOLDBACK + RAM_CMD + RAM_STACK)
 
 /* Utility functions */
 
 #ifdef WITH_COM
 // Send a character to the UART
-static void uart_putchar(char c)
+void com_putchar(char c)
 {
+# ifdef WITH_STACK
+  stack_mark(); // the deepest point of every report
+# endif
   if (c == '\n') c = '\r';  // Windows-style CRLF
 
   loop_until_bit_is_set(UCSRA, UDRE); // wait until UART is ready to accept a new character
   UDR = c;              // send 1 character
 }
 
-static void uart_putuint(uint32_t x)
+# ifdef WITH_PERSIST
+// Report the lifetime counts and uptime (in seconds)
+static void print_lifetime(void)
 {
-  if (x < 10) {
-    uart_putchar(x + '0');
-  } else {
-    ldiv_t const r = uldiv(x, 10U);
-    uart_putuint(r.quot);
-    uart_putuint(r.rem);
+  com_putchar('#');
+  com_putulong(persist_counts());
+  com_putchar(',');
+  com_putulong(persist_seconds());
+  com_putchar('\n');
+}
+# endif
+
+# ifdef WITH_STACK
+// Report the never used stack bytes and the stack depth of main and each
+// ISR path
+static void print_stack(void)
+{
+  com_putchar('M');
+  com_putuint(stack_unused());
+  for (uint8_t p = 0; p < STACK_PATHS; p++) {
+    com_putchar(',');
+    com_putuint(stack_depth[p]);
   }
+  com_putchar('\n');
 }
+# endif
 #endif
 
 /* Events */
@@ -127,48 +248,48 @@ static struct event bip_stop_e;
 // Run this every seconds
 static void every_second(struct event *e)
 {
-  static uint8_t buffer[30]; // the sample buffer. Any 255 means overflow.
-  static uint8_t idx;         // sample buffer index
-
   //BIT_FLIP(PORTB, PB4);  // toggle the LED (for debugging purposes)
 
   uint8_t const c_cps = cps;  // non valoatile copy
   cps = 0;  // reset counter
 
-  buffer[idx] = c_cps;   // save current sample to buffer (replacing old value)
-  if (++idx >= SIZEOF_ARRAY(buffer)) idx = 0;
+  struct dose_report r;
+  dose_second(&dose, c_cps, &r);
+# ifdef WITH_PERSIST
+  persist_second(c_cps);
+# endif
+# ifdef WITH_HISTORY
+  history_second(&history, c_cps);
+  // Display and report that average instead, if there is one (overflow
+  // still refers to the short window)
+  if (HORIZON != HISTORY_NONE && history_cpm(&history, HORIZON, &r.cpm)) {
+    r.siv = dose_siv_of_cpm(r.cpm);
+  }
+# endif
+# ifdef WITH_FOLDBACK
+  // INT0 is on PD2, which stays low for the duration of a pulse
+  r.foldback = foldback_second(&foldback, c_cps, bit_is_clear(PIND, PD2));
+  if (r.foldback) {
+    bubble_set_overload(&bubble);
+  } else {
+    bubble_set_float(&bubble, r.siv, 3);
+  }
+# else
+  bubble_set_float(&bubble, r.siv, 3);
+# endif
 
-# ifdef WITH_COM
+# ifdef WITH_CMD
+  // Log data over the serial port, as often as requested
+  summary_second(&summary, &r);
+# elif defined(WITH_COM)
   // Log data over the serial port
-  if (c_cps >= UINT8_MAX) uart_putchar('>');
-  uart_putuint(c_cps);
-  uart_putchar(',');
-  uint8_t overflow = 0;
+  com_print_dose(&r);
 # endif
-
-  uint16_t cpm = 0;
-  for (uint8_t i = 0; i < SIZEOF_ARRAY(buffer); i++) {
-#   ifdef WITH_COM
-    if (buffer[i] == UINT8_MAX) overflow = 1;
-#   endif
-    cpm += buffer[i];
+# ifdef WITH_STACK
+  if (! --stack_report_in) {
+    print_stack();
+    stack_report_in = STACK_REPORT_PERIOD;
   }
-  cpm <<= 1;  // since we have only 30secs
-# ifdef WITH_COM
-  if (overflow) uart_putchar('>');
-  uart_putuint(cpm);
-  uart_putchar(',');
-# endif
-  // Display CPM * 0.0057 aka something close to uSv/hr.
-  // We keep one digit for the integral part and 3 for the decimal part
-  // (otherwise you have bigger problems).
-  // So we actually want 1000*uSv/hr. We thus mult by 5.7.
-  uint16_t siv = (cpm * 1459UL) >> 8U;
-  bubble_set_float(&bubble, siv, 3);
-
-# ifdef WITH_COM
-  uart_putuint(siv);
-  uart_putchar('\n');
 # endif
 
   // Reschedule
@@ -200,14 +321,109 @@ static void bip_start(void)
 
 //  Pin change interrupt for pin INT0
 //  This interrupt is called on the falling edge of a GM pulse.
+#ifdef WITH_FAST_INT0
+//  Only count the pulse (in r2, capped at 255) and tell main to bip.
+//  r3 is reserved to save SREG, so nothing is pushed. From the pulse edge to
+//  the end of reti that's 17 cycles (2us at 8MHz): 4 for the interrupt
+//  response, 2 for the vector's rjmp, then 11 below, whether the counter
+//  saturates or not (WITH_STACK adds its own instrumentation).
+//  The regular ISR calls event_register (through bip_start), so it must save
+//  r0, r1, SREG and the 12 call-clobbered registers. Counted from the ABI
+//  and the source, not from a listing, its cycles add up to roughly:
+//    interrupt response and rjmp                                       6
+//    prologue: 14 push, in SREG, clr r1                              30
+//    counter and bip_start's timer writes                            20
+//    event_register: arguments, call, walking two events, ret       ~90
+//    epilogue: 14 pop, out SREG, reti                                33
+//  about 180 cycles (22us at 8MHz), ten times the above. Check against
+//  "make geiger.lst" when changing either.
+//  Both ISRs count at most 255 pulses per second, as cps is 8 bits wide
+//  all the way to dose_second: this one only gets to counting sooner.
+ISR(INT0_vect, ISR_NAKED)
+{
+  __asm volatile (
+    "    in r3, __SREG__\n"  // 1
+#   ifdef WITH_STACK
+    // stack_mark(), for STACK_INT0. We have to push some registers, so
+    // this overestimates the depth by 2 bytes.
+    "    push r24\n"
+    "    push r25\n"
+    "    ldi r24, %2\n"
+    "    in r25, __SP_L__\n"
+    "    sub r24, r25\n"
+    "    lds r25, stack_depth+%3\n"
+    "    cp r25, r24\n"
+    "    brsh 2f\n"
+    "    sts stack_depth+%3, r24\n"
+    "2:  pop r25\n"
+    "    pop r24\n"
+#   endif
+    "    inc r2\n"   // 1
+    "    brne 1f\n"  // 2, or 1 if not taken...
+    "    dec r2\n"   // ...plus 1 to go back to 255 on overflow
+    "1:  sbi %0, %1\n"  // 2
+    "    out __SREG__, r3\n"  // 1
+    "    reti\n" // 4
+    :: "I" (_SFR_IO_ADDR(GPIOR0)), "I" (PULSE_FLAG)
+#   ifdef WITH_STACK
+    , "M" (RAMEND & 0xff), "n" (STACK_INT0)
+#   endif
+  );
+}
+#else
 ISR(INT0_vect)
 {
+# ifdef WITH_STACK
+  stack_enter(STACK_INT0);
+# endif
   uint8_t const c_cps = cps;  // non volatile copy
   if (c_cps < UINT8_MAX) // check for overflow, if we do overflow just cap the counts at max possible
     cps = c_cps + 1; // increase event counter
 
   bip_start();
+# ifdef WITH_STACK
+  stack_leave();
+# endif
+}
+#endif
+
+#ifdef WITH_CMD
+// Commands received over the serial link:
+// - iN: report every N seconds (0 for never);
+// - r: report CPS, CPM, dose;
+// - s: report summaries (see summary.h).
+// They only change settings: reports are all sent from every_second, since
+// we do not want to block here while the UART is busy.
+static void cmd_exec(char name, uint8_t arg)
+{
+  switch (name) {
+    case 'i': summary_ctor(&summary, arg, summary.mode); break;
+    case 'r': summary_ctor(&summary, summary.interval, SUMMARY_RAW); break;
+    case 's': summary_ctor(&summary, summary.interval, SUMMARY_BATCH); break;
+    default: break; // unknown commands are ignored
+  }
+}
+
+ISR(USART_RX_vect)
+{
+# ifdef WITH_STACK
+  stack_enter(STACK_RX);
+# endif
+  // Reports are sent from TIMER1 and can keep us from reading UDR long
+  // enough for chars to be lost. Never apply a command missing some of
+  // them (such as "i12" for "i120"). Error flags must be read before UDR.
+  uint8_t const status = UCSRA;
+  char const c = UDR;
+  if (status & (_BV(DOR) | _BV(FE))) {
+    cmd_ctor(&cmd);
+  } else if (cmd_feed(&cmd, c)) {
+    cmd_exec(cmd.name, cmd.arg);
+  }
+# ifdef WITH_STACK
+  stack_leave();
+# endif
 }
+#endif
 
 /* Display driver callbacks */
 void set_digits(uint8_t s)
@@ -228,7 +444,26 @@ void set_segments(uint8_t s)
 // Start of main program
 int main(void)
 {
+# ifdef WITH_FAST_INT0
+  cps = 0;  // unlike RAM, registers are not cleared at reset
+# endif
+  // Too many features enabled at once? See RAM budget above.
+# ifdef WITH_STACK
+  // Let any combination be measured: stack_report.sh tells when the stack
+  // ran past the painted RAM.
+  ASSERT_COMPILE(RAM_STATIC < RAMEND + 1U - RAMSTART);
+# else
+  ASSERT_COMPILE(RAM_STATIC + STACK_RESERVE <= RAMEND + 1U - RAMSTART);
+# endif
+
   bubble_ctor(&bubble);
+  dose_ctor(&dose);
+# ifdef WITH_HISTORY
+  history_ctor(&history);
+# endif
+# ifdef WITH_FOLDBACK
+  foldback_ctor(&foldback);
+# endif
 
   // Configure the UART
   // Set baud rate generator based on F_CPU
@@ -237,6 +472,11 @@ int main(void)
 
   // Enable USART transmitter and receiver
   UCSRB = (1<<RXEN) | (1<<TXEN);
+# ifdef WITH_CMD
+  summary_ctor(&summary, REPORT_INTERVAL, SUMMARY_RAW);
+  cmd_ctor(&cmd);
+  BIT_SET(UCSRB, RXCIE);  // commands are parsed from USART_RX_vect
+# endif
 
   // Set up AVR IO ports
   // PB4 is for the LED, PB2 for the piezzo, PB0,1,3 for digit selection:
@@ -253,6 +493,13 @@ int main(void)
   TCCR0A = (0<<COM0A1) | (1<<COM0A0) | (0<<WGM02) |  (1<<WGM01) | (0<<WGM00);
   TCCR0B = 0; // stop Timer0 (no sound)
 
+# ifdef WITH_PERSIST
+  persist_init();
+#   ifdef WITH_COM
+  print_lifetime();
+#   endif
+# endif
+
   event_init();
   event_ctor(&every_second_e);
   event_ctor(&bip_stop_e);
@@ -261,6 +508,15 @@ int main(void)
   // Configure AVR for sleep, this saves a couple mA when idle
   set_sleep_mode(SLEEP_MODE_IDLE);  // CPU will go to sleep but peripherals keep running
   forever {  // loop forever
+#   ifdef WITH_FAST_INT0
+    cli();
+    if (bit_is_set(GPIOR0, PULSE_FLAG)) {
+      // Bip with interrupts disabled, as if we were still in INT0
+      BIT_CLEAR(GPIOR0, PULSE_FLAG);
+      bip_start();
+      continue;
+    }
+#   endif
     sleep_enable();
     sei();
     sleep_cpu();    // put the core to sleep
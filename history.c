@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "miscmacs.h"
+#include "history.h"
+
+void history_ctor(struct history *h)
+{
+  h->seconds = 0;
+  h->counts = 0;
+  h->period_idx = h->periods_filled = 0;
+  h->slot_periods = 0;
+  h->slot_sum = 0;
+  h->slot_idx = h->slots_filled = 0;
+}
+
+// Store v in a ring of n entries
+static void ring_push(uint8_t *ring, uint8_t n, uint8_t *idx, uint8_t *filled, uint8_t v)
+{
+  ring[*idx] = v;
+  if (++*idx >= n) *idx = 0;
+  if (*filled < n) ++*filled;
+}
+
+// Take as many units as possible out of *acc, leaving the remainder for
+// the next entry (or nothing if we saturate).
+static uint8_t take_units(uint16_t *acc, uint8_t per_unit)
+{
+  div_t const r = udiv(*acc, per_unit);
+  if (r.quot > UINT8_MAX) {
+    *acc = 0;
+    return UINT8_MAX;
+  }
+  *acc = r.rem;
+  return r.quot;
+}
+
+static void history_period(struct history *h)
+{
+  uint8_t const v = take_units(&h->counts, HISTORY_PERIOD_COUNTS);
+  ring_push(h->periods, HISTORY_PERIODS, &h->period_idx, &h->periods_filled, v);
+
+  h->slot_sum += v;
+  if (++h->slot_periods < HISTORY_SLOT_PERIODS) return;
+  h->slot_periods = 0;
+  uint8_t const s = take_units(&h->slot_sum, HISTORY_SLOT_PERIODS);
+  ring_push(h->slots, HISTORY_SLOTS, &h->slot_idx, &h->slots_filled, s);
+}
+
+void history_second(struct history *h, uint8_t cps)
+{
+  h->counts += cps;
+  if (++h->seconds < HISTORY_PERIOD) return;
+  h->seconds = 0;
+  history_period(h);
+}
+
+static bool ring_cpm(uint8_t const *ring, uint8_t filled, uint16_t *cpm)
+{
+  if (! filled) return false;
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < filled; i++) {
+    if (ring[i] == UINT8_MAX) return false;
+    sum += ring[i];
+  }
+  *cpm = udiv(sum * HISTORY_UNIT, filled).quot;
+  return true;
+}
+
+bool history_cpm(struct history const *h, enum history_horizon horizon, uint16_t *cpm)
+{
+  // Until the first slot is complete, the periods are all we have
+  if (horizon == HISTORY_LONG && h->slots_filled) {
+    return ring_cpm(h->slots, h->slots_filled, cpm);
+  }
+  return ring_cpm(h->periods, h->periods_filled, cpm);
+}
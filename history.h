@@ -0,0 +1,66 @@
+/* Long term history of the counts, in constant memory.
+ *
+ * Seconds are added up into periods of HISTORY_PERIOD seconds, kept in a
+ * ring of HISTORY_PERIODS entries, and those are averaged into slots of
+ * HISTORY_SLOT_PERIODS periods, kept in a ring of HISTORY_SLOTS entries.
+ * Each second costs O(1); averages are computed on demand from the rings.
+ *
+ * Both rings store a CPM / HISTORY_UNIT in a single byte, the remainder
+ * being carried over to the next entry so that averages stay accurate. They
+ * saturate at 255 * HISTORY_UNIT CPM (about 22uSv/hr), in which case no
+ * average is given and the short window of struct dose must be used.
+ *
+ * With the default settings that's 10 minutes (in 2 minutes periods) and
+ * 24 hours (in 4 hours slots) for 21 bytes of RAM.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#ifndef HISTORY_H_261018
+#define HISTORY_H_261018
+
+#define HISTORY_UNIT 15U  // CPM per unit of the stored values
+#ifndef HISTORY_PERIOD
+#   define HISTORY_PERIOD 120U // seconds, multiple of 60/HISTORY_UNIT
+#endif
+#ifndef HISTORY_PERIODS
+#   define HISTORY_PERIODS 5U
+#endif
+#ifndef HISTORY_SLOT_PERIODS
+#   define HISTORY_SLOT_PERIODS 120U  // at most 255
+#endif
+#ifndef HISTORY_SLOTS
+#   define HISTORY_SLOTS 6U
+#endif
+
+// Counts per period for one unit
+#define HISTORY_PERIOD_COUNTS (HISTORY_PERIOD * HISTORY_UNIT / 60U)
+
+enum history_horizon {
+  HISTORY_NONE, // use the short window of struct dose instead
+  HISTORY_SHORT,  // HISTORY_PERIODS * HISTORY_PERIOD seconds
+  HISTORY_LONG, // HISTORY_SLOTS * HISTORY_SLOT_PERIODS periods
+};
+
+struct history {
+  uint8_t seconds;  // into current period
+  uint16_t counts;  // counts so far during current period, plus carry
+  uint8_t period_idx, periods_filled;
+  uint8_t periods[HISTORY_PERIODS];
+  uint8_t slot_periods; // into current slot
+  uint16_t slot_sum;  // sum of the periods of current slot, plus carry
+  uint8_t slot_idx, slots_filled;
+  uint8_t slots[HISTORY_SLOTS];
+};
+
+void history_ctor(struct history *);
+
+// Add the counts of the last second (call it every second).
+void history_second(struct history *, uint8_t cps);
+
+// Set *cpm to the average CPM over the given horizon (HISTORY_SHORT or
+// HISTORY_LONG), or over what's been recorded so far if that's less.
+// Returns false if there is no meaningful average yet, or if some entry
+// saturated.
+bool history_cpm(struct history const *, enum history_horizon, uint16_t *cpm);
+
+#endif
@@ -37,8 +37,14 @@
 #define forever for (;;)
 #define DIV_ROUND(a, b) (((a)+(a>>1))/b)
 
+#ifdef __AVR__
 // Save us from linking in __divmodhi4 (assume __udivmodhi4 is already there)
 div_t udiv(unsigned __num, unsigned __denom) __asm__("__udivmodhi4") __ATTR_CONST__;
 ldiv_t uldiv(unsigned long __num, unsigned long __denom) __asm__("__udivmodsi4") __ATTR_CONST__;
+#else
+// When built natively (see replay.c) the signed versions will do
+#   define udiv(n, d) div(n, d)
+#   define uldiv(n, d) ldiv(n, d)
+#endif
 
 #endif
@@ -0,0 +1,116 @@
+// Wear leveled lifetime accumulator in EEPROM
+#include <stdlib.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "miscmacs.h"
+#include "cpp.h"
+#include "persist.h"
+
+// Last committed record, also the source of the bytes being written
+static struct persist_record rec;
+static uint8_t slot;  // where rec is (or is being written)
+static uint8_t wr_idx = sizeof(rec); // next byte of rec to write, if < sizeof(rec)
+
+// Batch of what happened since rec
+static uint16_t pending_counts;
+static uint16_t pending_seconds;
+
+static uint8_t *slot_addr(uint8_t s)
+{
+  return (uint8_t *)(uintptr_t)(s * sizeof(struct persist_record));
+}
+
+static uint8_t crc_of(struct persist_record const *r)
+{
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < offsetof(struct persist_record, crc); i++) {
+    crc = _crc_ibutton_update(crc, ((uint8_t const *)r)[i]);
+  }
+  return crc;
+}
+
+static bool read_slot(uint8_t s, struct persist_record *r)
+{
+  eeprom_read_block(r, slot_addr(s), sizeof(*r));
+  return r->crc == crc_of(r);
+}
+
+// Records are written in ring order with consecutive sequence numbers, so
+// the last one is the valid record which successor is not its follow-up
+// (either because it's older or because it was torn by a power loss).
+// This reads each slot once, which takes well under a millisecond.
+void persist_init(void)
+{
+  struct persist_record r, next;
+  bool valid = read_slot(0, &r);
+  for (uint8_t s = 0; s < PERSIST_SLOTS; s++) {
+    uint8_t const ns = s + 1U < PERSIST_SLOTS ? s + 1U : 0U;
+    bool const next_valid = read_slot(ns, &next);
+    if (valid && (! next_valid || next.seq != (uint8_t)(r.seq + 1))) {
+      rec = r;
+      slot = s;
+      return;
+    }
+    r = next;
+    valid = next_valid;
+  }
+  // Blank (or totally corrupted) EEPROM: start from zero. The first commit
+  // will go to slot 0.
+  rec.seq = 0xff;
+  rec.counts = 0;
+  rec.seconds = 0;
+  slot = PERSIST_SLOTS - 1;
+}
+
+static void commit(void)
+{
+  rec.seq ++;
+  rec.counts += pending_counts;
+  rec.seconds += pending_seconds;
+  rec.crc = crc_of(&rec);
+  pending_counts = 0;
+  pending_seconds = 0;
+  if (++slot >= PERSIST_SLOTS) slot = 0;
+  wr_idx = 0;
+  BIT_SET(EECR, EERIE);  // EEPROM_READY_vect will do the rest
+}
+
+// Called from the timer ISR, so EEPROM_READY_vect cannot fire meanwhile.
+void persist_second(uint8_t cps)
+{
+  pending_counts += cps;
+  pending_seconds ++;
+  // Do not touch rec while it's being written; we will retry next second.
+  if (unlikely_(wr_idx < sizeof(rec))) return;
+  if (pending_seconds >= PERSIST_PERIOD || pending_counts > UINT16_MAX - 2U*UINT8_MAX) {
+    commit();
+  }
+}
+
+// Fires whenever the EEPROM is ready for another write, as long as EERIE is set
+ISR(EEPROM_READY_vect)
+{
+  if (wr_idx >= sizeof(rec)) {
+    BIT_CLEAR(EECR, EERIE);
+    return;
+  }
+  EEAR = (uint8_t)(uintptr_t)slot_addr(slot) + wr_idx;
+  EEDR = ((uint8_t const *)&rec)[wr_idx++];
+  // EEPE must be set within 4 cycles after EEMPE, we are in an ISR so
+  // nothing can interrupt us:
+  BIT_SET(EECR, EEMPE);
+  BIT_SET(EECR, EEPE);
+}
+
+uint32_t persist_counts(void)
+{
+  return rec.counts + pending_counts;
+}
+
+uint32_t persist_seconds(void)
+{
+  return rec.seconds + pending_seconds;
+}
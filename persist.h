@@ -0,0 +1,43 @@
+/* Lifetime counts and uptime, kept in EEPROM across power cycles.
+ *
+ * Counts are batched in RAM and committed every PERSIST_PERIOD seconds
+ * (or sooner if the batch is about to overflow) into the next slot of a
+ * ring of records, each with a sequence number and a CRC. The bytes are
+ * written one at a time from the EEPROM ready interrupt so that nothing
+ * ever waits for the ~3.4ms a byte takes to be written.
+ *
+ * With 12 slots, each cell is rewritten once every 12 commits, ie. every
+ * 3 hours, which gives the 100k guaranteed erase/write cycles a lifetime
+ * of more than 30 years.
+ */
+#include <stdint.h>
+#ifndef PERSIST_H_261018
+#define PERSIST_H_261018
+
+#ifndef PERSIST_PERIOD
+#   define PERSIST_PERIOD 900U  // seconds between commits
+#endif
+
+struct persist_record {
+  uint8_t seq;  // incremented at each commit, modulo 256
+  uint32_t counts;  // lifetime GM counts
+  uint32_t seconds; // lifetime uptime
+  uint8_t crc;  // over all previous bytes
+} __attribute__((__packed__));
+
+#define PERSIST_SLOTS ((E2END + 1U) / sizeof(struct persist_record))
+
+// RAM used by persist.c: the current record, plus 6 bytes of state
+#define PERSIST_RAM (sizeof(struct persist_record) + 6U)
+
+// Look for the last valid record. Must be called before interrupts are enabled.
+void persist_init(void);
+
+// Add the counts of the last second (call it every second).
+void persist_second(uint8_t cps);
+
+// Lifetime totals, including what has not been committed yet.
+uint32_t persist_counts(void);
+uint32_t persist_seconds(void);
+
+#endif
@@ -0,0 +1,227 @@
+/* Replay recorded or synthetic pulse timelines through the firmware's
+ * averaging logic, natively and as fast as the host allows.
+ *
+ * Build with "make replay".
+ *
+ * Usage: replay [-p] [-i interval] [-s] [-H horizon] [-f] [-j jobs] [file...]
+ *
+ * Each input is either:
+ * - one line per second, whose first comma separated field is the number
+ *   of counts during that second (so that what the device logged over the
+ *   serial link can be replayed as is: a leading '!' is ignored and a
+ *   leading '>' means the counter saturated);
+ * - or, with -p, one pulse timestamp per line, in microseconds since the
+ *   start of the recording, in increasing order.
+ *
+ * For each second, what the bubble display would show is printed,
+ * followed by a tab and the line the device would have sent over the
+ * serial link, if any (terminated by LF where the device sends CR).
+ * As with the "i" and "s" commands of the device, -i selects the number of
+ * seconds between reports and -s replaces them by summaries (see
+ * summary.h), and as with HORIZON -H selects the averaging horizon (see
+ * history.h). As with WITH_FOLDBACK, -f warns of
+ * fold-back (see foldback.h), although as there is no pulse line to sample
+ * here it is only detected from the counts; the display then shows "====".
+ *
+ * Without file, stdin is replayed to stdout. Otherwise each file is
+ * replayed into file.replay, up to "jobs" files at a time (default: one
+ * per CPU).
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "miscmacs.h"
+#include "dose.h"
+#include "com.h"
+#include "summary.h"
+#include "history.h"
+#include "foldback.h"
+
+static FILE *out;
+static uint8_t interval = 1;
+static enum summary_mode mode = SUMMARY_RAW;
+static enum history_horizon horizon = HISTORY_NONE;
+static bool with_foldback = false;
+static char last_char;
+
+// Unlike the device, keep LF as the line terminator
+void com_putchar(char c)
+{
+  putc(c, out);
+  last_char = c;
+}
+
+// What bubble_set_float(siv, 3) lits: 4 digits, decimal point after the first.
+static void print_display(uint16_t siv)
+{
+  char digits[4];
+  for (unsigned d = 0; d < SIZEOF_ARRAY(digits); d++) {
+    digits[d] = '0' + siv % 10U;
+    siv /= 10U;
+  }
+  fprintf(out, "%c.%c%c%c\t", digits[3], digits[2], digits[1], digits[0]);
+  last_char = '\t';
+}
+
+struct replay {
+  struct dose dose;
+  struct summary summary;
+  struct history history;
+  struct foldback foldback;
+};
+
+static void replay_second(struct replay *rp, uint8_t cps)
+{
+  struct dose_report r;
+  dose_second(&rp->dose, cps, &r);
+  history_second(&rp->history, cps);
+  if (horizon != HISTORY_NONE && history_cpm(&rp->history, horizon, &r.cpm)) {
+    r.siv = dose_siv_of_cpm(r.cpm);
+  }
+  if (with_foldback) r.foldback = foldback_second(&rp->foldback, cps, false);
+  if (r.foldback) {
+    fputs("====\t", out);
+    last_char = '\t';
+  } else {
+    print_display(r.siv);
+  }
+  summary_second(&rp->summary, &r);
+  // Terminate the line if the device had nothing to say
+  if (last_char != '\n') com_putchar('\n');
+}
+
+// Like the INT0 ISR, cap the counts at what the 8 bits counter can hold
+static uint8_t cap(unsigned long n)
+{
+  return n < UINT8_MAX ? n : UINT8_MAX;
+}
+
+static int replay_counts(FILE *in, struct replay *rp)
+{
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    char const *s = line;
+    if (*s == '!') s++; // fold-back warning
+    bool const saturated = *s == '>';
+    if (saturated) s++;
+    char *end;
+    errno = 0;
+    unsigned long const n = strtoul(s, &end, 10);
+    if (end == s || errno) continue;  // skip headers, comments and garbage
+    replay_second(rp, saturated ? UINT8_MAX : cap(n));
+  }
+  return ferror(in) ? -1 : 0;
+}
+
+static int replay_pulses(FILE *in, struct replay *rp)
+{
+  unsigned long long second = 0;  // current second
+  unsigned long count = 0;  // pulses during that second
+  unsigned long long us;
+  while (1 == fscanf(in, "%llu", &us)) {
+    while (us >= (second + 1) * 1000000ULL) {
+      replay_second(rp, cap(count));
+      count = 0;
+      second ++;
+    }
+    count ++;
+  }
+  if (count) replay_second(rp, cap(count));
+  return ferror(in) ? -1 : 0;
+}
+
+static int replay(FILE *in, bool pulses)
+{
+  struct replay rp;
+  dose_ctor(&rp.dose);
+  summary_ctor(&rp.summary, interval, mode);
+  history_ctor(&rp.history);
+  foldback_ctor(&rp.foldback);
+  int const err = pulses ? replay_pulses(in, &rp) : replay_counts(in, &rp);
+  return fflush(out) || err ? -1 : 0;
+}
+
+static int replay_file(char const *fname, bool pulses)
+{
+  FILE *in = fopen(fname, "r");
+  if (! in) {
+    fprintf(stderr, "Cannot open %s: %s\n", fname, strerror(errno));
+    return -1;
+  }
+  char outname[strlen(fname) + sizeof(".replay")];
+  sprintf(outname, "%s.replay", fname);
+  out = fopen(outname, "w");
+  if (! out) {
+    fprintf(stderr, "Cannot create %s: %s\n", outname, strerror(errno));
+    fclose(in);
+    return -1;
+  }
+  int err = replay(in, pulses);
+  if (err) fprintf(stderr, "Cannot replay %s\n", fname);
+  fclose(in);
+  if (fclose(out)) err = -1;
+  return err;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "replay [-p] [-i interval] [-s] [-H horizon] [-f] [-j jobs] [file...]\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  bool pulses = false;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while (-1 != (opt = getopt(argc, argv, "pi:sH:fj:"))) {
+    switch (opt) {
+      case 'p': pulses = true; break;
+      case 'i': interval = MIN(atoi(optarg), UINT8_MAX); break;
+      case 's': mode = SUMMARY_BATCH; break;
+      case 'H': horizon = MIN(atoi(optarg), HISTORY_LONG); break;
+      case 'f': with_foldback = true; break;
+      case 'j': jobs = atol(optarg); break;
+      default: usage();
+    }
+  }
+  if (jobs < 1) jobs = 1;
+
+  if (optind >= argc) {
+    out = stdout;
+    return replay(stdin, pulses) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // One process per file, at most jobs at a time
+  int ret = EXIT_SUCCESS;
+  long running = 0;
+  for (int i = optind; i < argc || running > 0; ) {
+    if (i < argc && running < jobs) {
+      pid_t const pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        ret = EXIT_FAILURE;
+        break;
+      } else if (pid == 0) {
+        _exit(replay_file(argv[i], pulses) ? EXIT_FAILURE : EXIT_SUCCESS);
+      }
+      running ++;
+      i ++;
+    } else {
+      int status;
+      if (wait(&status) < 0) break;
+      running --;
+      if (! WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) ret = EXIT_FAILURE;
+    }
+  }
+  while (running > 0 && wait(NULL) > 0) running --;
+
+  return ret;
+}
@@ -0,0 +1,41 @@
+// Stack painting and high water mark
+#include <stdlib.h>
+#include "miscmacs.h"
+#include "stack.h"
+
+extern uint8_t _end;  // end of .bss, from the linker
+extern uint8_t __stack; // top of the stack, idem
+
+uint8_t stack_depth[STACK_PATHS];
+uint8_t stack_path;
+
+extern inline void stack_enter(enum stack_path);
+extern inline void stack_leave(void);
+extern inline void stack_mark(void);
+
+// This runs from .init1, before the stack pointer and r1 are even set up,
+// so only use registers that we know of.
+void stack_paint(void) __attribute__((naked, used, section(".init1")));
+void stack_paint(void)
+{
+  __asm volatile (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" (STACK_CANARY)
+  );
+}
+
+uint8_t stack_unused(void)
+{
+  uint8_t const *p = &_end;
+  while (p <= &__stack && *p == STACK_CANARY) p++;
+  return p - &_end;
+}
@@ -0,0 +1,50 @@
+/* Stack usage measurement.
+ *
+ * Before main, the RAM between the end of .bss and the top of the stack is
+ * painted with STACK_CANARY, so that the number of bytes never written
+ * since tells the overall headroom.
+ *
+ * In addition, stack_mark() records the deepest stack seen so far by the
+ * path being run, as set by each ISR with stack_enter() and stack_leave().
+ * It is called at the leaves of each path: event_register (every path),
+ * com_putchar (the bottom of every report), cmd_feed and summary_ctor (the
+ * RX path) and the ISRs that call nothing. Depths are counted from the top of the RAM, so an ISR's depth
+ * includes whatever it interrupted. Since no ISR re-enables interrupts they
+ * never nest.
+ *
+ * stack_report.sh combines these measures with the linker map.
+ */
+#include <stdint.h>
+#include <avr/io.h>
+#ifndef STACK_H_261018
+#define STACK_H_261018
+
+#define STACK_CANARY 0xc5
+
+enum stack_path { STACK_MAIN, STACK_INT0, STACK_TIMER1, STACK_RX, STACK_PATHS };
+
+// Max bytes of stack used so far, per path
+extern uint8_t stack_depth[STACK_PATHS];
+// Path being run
+extern uint8_t stack_path;
+
+static inline void stack_enter(enum stack_path p)
+{
+  stack_path = p;
+}
+
+static inline void stack_leave(void)
+{
+  stack_path = STACK_MAIN;
+}
+
+static inline void stack_mark(void)
+{
+  uint8_t const depth = RAMEND - SP;
+  if (depth > stack_depth[stack_path]) stack_depth[stack_path] = depth;
+}
+
+// Number of painted bytes that were never written.
+uint8_t stack_unused(void);
+
+#endif
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Combine the static RAM usage from the linker map with the stack usage
+# measured by the firmware (built WITH_STACK), to know how much headroom is
+# left.
+#
+# Usage: stack_report.sh [geiger.elf.map] < capture
+#
+# where capture is what the device sent over the serial link, which reports
+# stack usage every minute (the last "M..." line is used). The overall depth
+# is compared to RESERVE, which should be the STACK_RESERVE of geiger.c for
+# the features that were built.
+
+map=${1:-geiger.elf.map}
+ram=${RAM:-128}	# ATtiny2313
+reserve=${RESERVE:-46}	# STACK_RESERVE with WITH_COM
+
+if ! test -r "$map" ; then
+	echo "Cannot read $map" >&2
+	exit 1
+fi
+
+awk -v ram="$ram" -v reserve="$reserve" '
+function hex(s,    i, v) {
+	v = 0
+	s = tolower(s)
+	sub(/^0x/, "", s)
+	for (i = 1; i <= length(s); i++)
+		v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+	return v
+}
+
+# The output sections of the map, such as:
+# .bss            0x00800062       0x40
+# (the indented lines are the input sections that make them up)
+FNR == NR {
+	if (/^\.(data|bss|noinit)[ \t]/) {
+		size[$1] = hex($3)
+		static += hex($3)
+	}
+	next
+}
+
+/^M[0-9]/ {
+	sub(/\r$/, "")
+	sub(/^M/, "")
+	measure = $0
+}
+
+END {
+	printf "%-8s %4d bytes\n", ".data", size[".data"]
+	printf "%-8s %4d bytes\n", ".bss", size[".bss"]
+	printf "%-8s %4d bytes\n", ".noinit", size[".noinit"]
+	painted = ram - static
+	printf "%-8s %4d bytes, leaving %d for the stack\n", "static", static, painted
+	if (measure == "") {
+		print "No measure (M line) in the capture" > "/dev/stderr"
+		exit 1
+	}
+	split(measure, m, ",")
+	printf "\n%-8s %4d bytes deep\n", "main", m[2]
+	printf "%-8s %4d bytes deep\n", "INT0", m[3]
+	printf "%-8s %4d bytes deep\n", "TIMER1", m[4]
+	printf "%-8s %4d bytes deep\n", "RX", m[5]
+	printf "%-8s %4d bytes deep (never used: %d)\n", "overall", painted - m[1], m[1]
+	printf "\nheadroom: %d bytes (%d%% of RAM)\n", m[1], m[1] * 100 / ram
+	deepest = painted - m[1]
+	for (i = 2; i <= 5; i++) if (m[i] > deepest) deepest = m[i]
+	if (m[1] == 0)
+		print "The stack ran past the painted RAM: build with fewer features" > "/dev/stderr"
+	else if (deepest > reserve)
+		printf "%d bytes deep, more than the %d bytes of STACK_RESERVE\n", deepest, reserve > "/dev/stderr"
+}' "$map" -
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "miscmacs.h"
+#include "com.h"
+#include "summary.h"
+#ifdef WITH_STACK
+#   include "stack.h"
+#endif
+
+static void summary_reset(struct summary *s)
+{
+# ifdef WITH_STACK
+  stack_mark(); // the deepest point of summary_ctor, called from the RX path
+# endif
+  s->n = 0;
+  s->min = UINT8_MAX;
+  s->max = 0;
+  s->sum = 0;
+  for (uint8_t b = 0; b < SUMMARY_BUCKETS; b++) s->hist[b] = 0;
+  s->foldback = false;
+}
+
+void summary_ctor(struct summary *s, uint8_t interval, enum summary_mode mode)
+{
+  s->interval = interval;
+  s->mode = mode;
+  summary_reset(s);
+}
+
+static uint8_t bucket_of_cps(uint8_t cps)
+{
+  return cps == 0 ? 0 : cps < 4U ? 1 : cps < 16U ? 2 : 3;
+}
+
+static void summary_print(struct summary const *s, struct dose_report const *r)
+{
+  if (s->foldback) com_putchar('!');
+  com_putchar('S');
+  com_putuint(s->n);
+  com_putchar(',');
+  com_putuint(s->min);
+  com_putchar(',');
+  com_putuint(s->max);
+  com_putchar(',');
+  com_putuint(s->sum);
+  for (uint8_t b = 0; b < SUMMARY_BUCKETS; b++) {
+    com_putchar(',');
+    com_putuint(s->hist[b]);
+  }
+  com_putchar(',');
+  if (r->cpm_overflow) com_putchar('>');
+  com_putuint(r->cpm);
+  com_putchar(',');
+  com_putuint(r->siv);
+  com_putchar('\n');
+}
+
+void summary_second(struct summary *s, struct dose_report const *r)
+{
+  if (! s->interval) return;
+
+  if (s->mode == SUMMARY_BATCH) {
+    if (r->cps < s->min) s->min = r->cps;
+    if (r->cps > s->max) s->max = r->cps;
+    s->sum += r->cps;
+    s->hist[bucket_of_cps(r->cps)] ++;
+    if (r->foldback) s->foldback = true;
+  }
+
+  if (++s->n < s->interval) return;
+
+  if (s->mode == SUMMARY_BATCH) {
+    summary_print(s, r);
+  } else {
+    com_print_dose(r);
+  }
+  summary_reset(s);
+}
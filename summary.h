@@ -0,0 +1,37 @@
+/* Select how often and what to report over the serial link: either the
+ * usual per-second line, or a summary of the last N seconds, which is much
+ * lighter for slow loggers but still tells the whole story:
+ *
+ * Sn,min,max,sum,h0,h1,h2,h3,cpm,siv
+ *
+ * where min, max and sum are those of the CPS over the n seconds, hX is the
+ * number of seconds with a CPS of 0, 1 to 3, 4 to 15 and 16 or more, and
+ * cpm and siv are those of the last second. The line is prefixed with '!'
+ * if the tube may have been saturated during any of these seconds.
+ */
+#include <stdint.h>
+#include "dose.h"
+#ifndef SUMMARY_H_261018
+#define SUMMARY_H_261018
+
+enum summary_mode { SUMMARY_RAW, SUMMARY_BATCH };
+
+#define SUMMARY_BUCKETS 4U
+
+struct summary {
+  uint8_t interval; // seconds between reports, 0 for no report at all
+  enum summary_mode mode;
+  uint8_t n;  // seconds since last report
+  uint8_t min, max;
+  uint16_t sum; // can't overflow since n <= 255
+  uint8_t hist[SUMMARY_BUCKETS];
+  bool foldback;
+};
+
+// Also used to change the interval/mode, which restarts accumulating.
+void summary_ctor(struct summary *, uint8_t interval, enum summary_mode);
+
+// Account for the last second and report whenever it's time to.
+void summary_second(struct summary *, struct dose_report const *);
+
+#endif